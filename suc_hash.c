@@ -0,0 +1,392 @@
+/* libsuc - Simple utilities for C
+ *
+ * Content hashing and checksums of simple static arrays.
+ *
+ * Copyright (c) 2017 - Devin Linnington
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "suc_hash.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define _CRC32C_HW 1
+#endif
+
+/*** xxhash64 *****/
+
+#define _H_P1 0x9E3779B185EBCA87ull
+#define _H_P2 0xC2B2AE3D27D4EB4Full
+#define _H_P3 0x165667B19E3779F9ull
+#define _H_P4 0x85EBCA77C2B2AE63ull
+#define _H_P5 0x27D4EB2F165667C5ull
+
+static inline uint64_t _rotl64(uint64_t x, unsigned r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+//unaligned little-endian reads
+static inline uint64_t _rd64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t _rd32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t _hash_round(uint64_t acc, uint64_t in)
+{
+    acc += in * _H_P2;
+    acc = _rotl64(acc, 31);
+    return acc * _H_P1;
+}
+
+static inline uint64_t _hash_merge(uint64_t acc, uint64_t v)
+{
+    acc ^= _hash_round(0, v);
+    return acc * _H_P1 + _H_P4;
+}
+
+//run full 32 byte stripes from p through the accumulators, returns number of bytes used
+static size_t _hash_stripes(uint64_t *v, const uint8_t *p, size_t size)
+{
+    uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+    const uint8_t *const start = p;
+    const uint8_t *const end = p + size;
+    while(end - p >= 32) {
+        v1 = _hash_round(v1, _rd64(p));
+        v2 = _hash_round(v2, _rd64(p+8));
+        v3 = _hash_round(v3, _rd64(p+16));
+        v4 = _hash_round(v4, _rd64(p+24));
+        p += 32;
+    }
+    v[0] = v1;
+    v[1] = v2;
+    v[2] = v3;
+    v[3] = v4;
+    return p - start;
+}
+
+void ssa_hash_init(struct ssa_hash_state *st, uint64_t seed)
+{
+    st->v[0] = seed + _H_P1 + _H_P2;
+    st->v[1] = seed + _H_P2;
+    st->v[2] = seed;
+    st->v[3] = seed - _H_P1;
+    st->seed = seed;
+    st->size = 0;
+}
+
+void ssa_hash_update(struct ssa_hash_state *st, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    size_t fill = st->size%32;
+    st->size += size;
+    if(fill) {
+        //top up the partial stripe first
+        size_t count = SUC_MIN(32 - fill, size);
+        memcpy(st->buf+fill, p, count);
+        p += count;
+        size -= count;
+        if(fill + count < 32) {
+            return;
+        }
+        _hash_stripes(st->v, st->buf, 32);
+    }
+    size_t used = _hash_stripes(st->v, p, size);
+    memcpy(st->buf, p+used, size-used);
+}
+
+uint64_t ssa_hash_digest(const struct ssa_hash_state *st)
+{
+    uint64_t h;
+    if(st->size >= 32) {
+        h = _rotl64(st->v[0], 1) + _rotl64(st->v[1], 7) + _rotl64(st->v[2], 12) + _rotl64(st->v[3], 18);
+        h = _hash_merge(h, st->v[0]);
+        h = _hash_merge(h, st->v[1]);
+        h = _hash_merge(h, st->v[2]);
+        h = _hash_merge(h, st->v[3]);
+    }
+    else {
+        h = st->seed + _H_P5;
+    }
+    h += st->size;
+
+    //the tail that didn't make a full stripe
+    const uint8_t *p = st->buf;
+    const uint8_t *const end = p + st->size%32;
+    while(end - p >= 8) {
+        h ^= _hash_round(0, _rd64(p));
+        h = _rotl64(h, 27) * _H_P1 + _H_P4;
+        p += 8;
+    }
+    if(end - p >= 4) {
+        h ^= (uint64_t)_rd32(p) * _H_P1;
+        h = _rotl64(h, 23) * _H_P2 + _H_P3;
+        p += 4;
+    }
+    while(p < end) {
+        h ^= *p * _H_P5;
+        h = _rotl64(h, 11) * _H_P1;
+        p++;
+    }
+
+    //avalanche
+    h ^= h >> 33;
+    h *= _H_P2;
+    h ^= h >> 29;
+    h *= _H_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t ssa_hash_sync(struct ssa_hash_state *st, const void *array)
+{
+    SSA_ASSERT_INIT(array);
+    const size_t size = ssa_size(array);
+    if(size < st->size) {
+        ssa_hash_init(st, st->seed);
+    }
+    ssa_hash_update(st, (const char*)array + st->size, size - st->size);
+    return ssa_hash_digest(st);
+}
+
+uint64_t _ssa_hash(const void *array, uint64_t seed)
+{
+    struct ssa_hash_state st;
+    ssa_hash_init(&st, seed);
+    return ssa_hash_sync(&st, array);
+}
+
+
+/*** crc32c *****/
+
+//reflected Castagnoli polynomial
+#define _CRC32C_POLY 0x82F63B78u
+
+//slicing-by-8 tables for the software version
+static uint32_t _crc32c_table[8][256];
+#if defined(_CRC32C_HW)
+static int _crc32c_hw;
+#endif
+
+__attribute__((constructor))
+static void _crc32c_init(void)
+{
+    for(unsigned i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for(int k = 0; k < 8; k++) {
+            c = (c >> 1) ^ (_CRC32C_POLY & (0u - (c & 1)));
+        }
+        _crc32c_table[0][i] = c;
+    }
+    for(unsigned i = 0; i < 256; i++) {
+        for(int t = 1; t < 8; t++) {
+            uint32_t c = _crc32c_table[t-1][i];
+            _crc32c_table[t][i] = (c >> 8) ^ _crc32c_table[0][c & 0xff];
+        }
+    }
+#if defined(_CRC32C_HW)
+    __builtin_cpu_init();
+    _crc32c_hw = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static uint32_t _crc32c_sw(uint32_t c, const uint8_t *p, size_t size)
+{
+    while(size && ((uintptr_t)p & 7)) {
+        c = (c >> 8) ^ _crc32c_table[0][(c ^ *p++) & 0xff];
+        size--;
+    }
+    while(size >= 8) {
+        uint32_t lo = _rd32(p) ^ c;
+        uint32_t hi = _rd32(p+4);
+        c = _crc32c_table[7][lo & 0xff] ^ _crc32c_table[6][(lo >> 8) & 0xff] ^
+            _crc32c_table[5][(lo >> 16) & 0xff] ^ _crc32c_table[4][lo >> 24] ^
+            _crc32c_table[3][hi & 0xff] ^ _crc32c_table[2][(hi >> 8) & 0xff] ^
+            _crc32c_table[1][(hi >> 16) & 0xff] ^ _crc32c_table[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while(size--) {
+        c = (c >> 8) ^ _crc32c_table[0][(c ^ *p++) & 0xff];
+    }
+    return c;
+}
+
+#if defined(_CRC32C_HW)
+__attribute__((target("sse4.2")))
+static uint32_t _crc32c_sse42(uint32_t c, const uint8_t *p, size_t size)
+{
+    while(size && ((uintptr_t)p & 7)) {
+        c = _mm_crc32_u8(c, *p++);
+        size--;
+    }
+#if defined(__x86_64__)
+    uint64_t c64 = c;
+    while(size >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c64 = _mm_crc32_u64(c64, v);
+        p += 8;
+        size -= 8;
+    }
+    c = (uint32_t)c64;
+#endif
+    while(size >= 4) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u32(c, v);
+        p += 4;
+        size -= 4;
+    }
+    while(size--) {
+        c = _mm_crc32_u8(c, *p++);
+    }
+    return c;
+}
+#endif
+
+uint32_t ssa_crc32c_update(uint32_t crc, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    uint32_t c = ~crc;
+#if defined(_CRC32C_HW)
+    if(_crc32c_hw) {
+        return ~_crc32c_sse42(c, p, size);
+    }
+#endif
+    return ~_crc32c_sw(c, p, size);
+}
+
+uint32_t ssa_crc32c_sync(struct ssa_crc32c_state *st, const void *array)
+{
+    SSA_ASSERT_INIT(array);
+    const size_t size = ssa_size(array);
+    if(size < st->size) {
+        st->crc = 0;
+        st->size = 0;
+    }
+    st->crc = ssa_crc32c_update(st->crc, (const char*)array + st->size, size - st->size);
+    st->size = size;
+    return st->crc;
+}
+
+
+/*** TEST stuff *****/
+#if defined(SUC_TEST_MAIN)
+#include <assert.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+struct test_bytes {
+    struct ssa_attr attr;
+    uint8_t array[1000];
+};
+
+struct test_u64 {
+    struct ssa_attr attr;
+    uint64_t array[100];
+};
+
+int main(void)
+{
+    struct test_bytes t1;
+    struct test_u64 t2;
+    uint8_t *a1;
+    uint64_t *a2;
+    uint8_t src[1000];
+    const char check[] = "123456789";
+    struct ssa_hash_state hs;
+    struct ssa_crc32c_state cs = SSA_CRC32C_STATE_INIT;
+    uint64_t h;
+    uint32_t c;
+    int i;
+
+    puts("\nTest known values");
+    a1 = ssa_new_empty(&t1.attr, t1.array);
+    printf("hash(\"\") = 0x%016" PRIx64 "\n", ssa_hash(a1));
+    assert(ssa_hash(a1) == 0xEF46DB3751D8E999ull);
+    assert(ssa_crc32c(a1) == 0);
+    ssa_cat(a1, check, strlen(check));
+    printf("crc32c(\"%s\") = 0x%08" PRIx32 "\n", check, ssa_crc32c(a1));
+    assert(ssa_crc32c(a1) == 0xE3069283u);
+    //seed changes the hash
+    assert(ssa_hash(a1) != ssa_hash(a1, 1));
+    assert(ssa_hash(a1, 1) == ssa_hash(a1, 1));
+
+    puts("\nTest crc32c hw/sw match");
+    for(i=0; i<SUC_LEN(src); i++) {
+        src[i] = (uint8_t)(i*31 + 7);
+    }
+    ssa_clear(a1);
+    ssa_cat(a1, src, sizeof(src));
+    for(i=0; i<64; i++) {
+        //every alignment and tail length
+        uint32_t sw = ~_crc32c_sw(~0u, a1+i, 900-i);
+        assert(ssa_crc32c_update(0, a1+i, 900-i) == sw);
+    }
+
+    puts("\nTest sync after cat");
+    ssa_clear(a1);
+    ssa_hash_init(&hs, 42);
+    for(i=0; i<100; i++) {
+        //odd sized appends so stripes get split every which way
+        ssa_cat(a1, src+i, i%13);
+        h = ssa_hash_sync(&hs, a1);
+        c = ssa_crc32c_sync(&cs, a1);
+        assert(h == ssa_hash(a1, 42));
+        assert(c == ssa_crc32c(a1));
+    }
+    printf("%zu bytes hash=0x%016" PRIx64 " crc32c=0x%08" PRIx32 "\n", ssa_size(a1), h, c);
+
+    //shrinking starts over
+    ssa_resize(a1, 10);
+    assert(ssa_hash_sync(&hs, a1) == ssa_hash(a1, 42));
+    assert(ssa_crc32c_sync(&cs, a1) == ssa_crc32c(a1));
+
+    puts("\nTest wider elements");
+    a2 = ssa_new_empty(&t2.attr, t2.array);
+    ssa_hash_init(&hs, 0);
+    for(i=0; i<SUC_LEN(t2.array); i++) {
+        ssa_push(a2, (uint64_t)i * 0x9E3779B97F4A7C15ull);
+        assert(ssa_hash_sync(&hs, a2) == ssa_hash(a2));
+    }
+    assert(ssa_size(a2) == sizeof(t2.array));
+
+    return 0;
+}
+#endif
@@ -0,0 +1,113 @@
+/* libsuc - Simple utilities for C
+ *
+ * Content hashing and checksums of simple static arrays.
+ *
+ * Copyright (c) 2017 - Devin Linnington
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SUC_HASH_H_
+#define _SUC_HASH_H_
+
+#include "suc_macros.h"
+#include "suc_ssa.h"
+
+/**
+ * State to hash a buffer in pieces, the result is the same as hashing it all
+ * at once. The hash is the xxhash64 algorithm, so it's stable across runs and
+ * machines and eats 32 bytes per step.
+ */
+struct ssa_hash_state {
+    //stripe accumulators
+    uint64_t v[4];
+    uint64_t seed;
+    //total bytes hashed so far
+    size_t size;
+    //the size%32 bytes that haven't made up a full stripe yet
+    uint8_t buf[32];
+};
+
+/**
+ * State to checksum a buffer in pieces
+ */
+struct ssa_crc32c_state {
+    uint32_t crc;
+    //total bytes checksummed so far
+    size_t size;
+};
+
+#define SSA_CRC32C_STATE_INIT {.crc=0, .size=0}
+
+/**
+ * Hash the used contents of an ssa array, ssa_size(array) bytes.
+ *
+ * ssa_hash(array)
+ * ssa_hash(array, seed)
+ */
+#define ssa_hash(...) SUC_VFUNC(_ssa_hash_, __VA_ARGS__)
+
+//start hashing with a seed
+void ssa_hash_init(struct ssa_hash_state *st, uint64_t seed);
+
+//hash size more bytes of data
+void ssa_hash_update(struct ssa_hash_state *st, const void *data, size_t size);
+
+//get the hash of everything so far, st can keep being updated after this
+uint64_t ssa_hash_digest(const struct ssa_hash_state *st);
+
+/**
+ * Bring st up to date with ssa array and return its hash. Only the bytes past
+ * st->size are hashed, so after ssa_cat/ssa_push only the new elements cost
+ * anything. If the array shrank it's rehashed from the start, but changes to
+ * elements already hashed aren't noticed.
+ *
+ * ex:
+ * struct ssa_hash_state st;
+ * ssa_hash_init(&st, 0);
+ * ssa_cat(array, more, sizeof(more));
+ * uint64_t h = ssa_hash_sync(&st, array);
+ */
+uint64_t ssa_hash_sync(struct ssa_hash_state *st, const void *array);
+
+/**
+ * Continue a crc32c of size bytes of data, start with crc=0.
+ * Uses the SSE4.2 crc32 instruction if the cpu has it.
+ */
+uint32_t ssa_crc32c_update(uint32_t crc, const void *data, size_t size);
+
+//crc32c of the used contents of an ssa array
+static inline uint32_t ssa_crc32c(const void *array)
+{
+    return ssa_crc32c_update(0, array, ssa_size(array));
+}
+
+//same as ssa_hash_sync but for a crc32c
+uint32_t ssa_crc32c_sync(struct ssa_crc32c_state *st, const void *array);
+
+// Internal stuff below, don't use these directly
+#define _ssa_hash_1(array)       _ssa_hash((array), 0)
+#define _ssa_hash_2(array, seed) _ssa_hash((array), (seed))
+
+uint64_t _ssa_hash(const void *array, uint64_t seed);
+
+#endif //_SUC_HASH_H_
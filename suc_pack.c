@@ -0,0 +1,719 @@
+/* libsuc - Simple utilities for C
+ *
+ * Integer compression codecs between simple static arrays.
+ *
+ * Copyright (c) 2017 - Devin Linnington
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "suc_pack.h"
+#include "suc_macros.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//most bytes a 64 bit varint can take
+#define _PACK_VARINT_MAX 10
+
+//mask to wrap deltas at the element width
+#define _PACK_MASK(esz) ((esz) == 4 ? (uint64_t)UINT32_MAX : UINT64_MAX)
+
+//load element i of an int array with element size esz
+static inline uint64_t _pack_load(const void *ints, size_t i, size_t esz)
+{
+    return esz == 4 ? ((const uint32_t*)ints)[i] : ((const uint64_t*)ints)[i];
+}
+
+//store v to element i of an int array with element size esz
+static inline void _pack_store(void *ints, size_t i, size_t esz, uint64_t v)
+{
+    if(esz == 4) {
+        ((uint32_t*)ints)[i] = (uint32_t)v;
+    }
+    else {
+        ((uint64_t*)ints)[i] = v;
+    }
+}
+
+//read/write little-endian 32 bit words, the compiler turns these into a single mov on x86
+static inline uint32_t _pack_rd32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void _pack_wr32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+//write v as a varint to p, returns number of bytes written
+static inline size_t _pack_put_varint(uint8_t *p, uint64_t v)
+{
+    size_t n = 0;
+    while(v >= 0x80) {
+        p[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+//returned by _pack_get_varint for a varint that can't be valid
+#define _PACK_BAD_VARINT ((size_t)-1)
+
+//read a varint no bigger than mask from p without going past end
+//returns number of bytes read, 0 if it's truncated, or _PACK_BAD_VARINT
+static inline size_t _pack_get_varint(const uint8_t *p, const uint8_t *end, uint64_t mask, uint64_t *v)
+{
+    uint64_t r = 0;
+    for(size_t n = 0; n < _PACK_VARINT_MAX; n++) {
+        if(p+n >= end) {
+            return 0;
+        }
+        //the last byte only has 1 bit left to give
+        if((n == _PACK_VARINT_MAX-1) && (p[n] > 1)) {
+            return _PACK_BAD_VARINT;
+        }
+        r |= (uint64_t)(p[n] & 0x7f) << (7*n);
+        if(!(p[n] & 0x80)) {
+            if(r > mask) {
+                return _PACK_BAD_VARINT;
+            }
+            *v = r;
+            return n+1;
+        }
+    }
+    return _PACK_BAD_VARINT;
+}
+
+//number of bits needed to hold v
+static inline unsigned _pack_bits(uint64_t v)
+{
+    return v ? 64 - __builtin_clzll(v) : 0;
+}
+
+size_t ssa_vbyte_encode_next(struct ssa_pack_stream *st, void *out, const void *ints)
+{
+    SSA_ASSERT_INIT(out);
+    SSA_ASSERT_INIT(ints);
+    assert(_ssa_esz(out) == 1);
+    const size_t esz = _ssa_esz(ints);
+    assert((esz == 4) || (esz == 8));
+    const size_t ilen = _ssa_len(ints);
+    const size_t cap = _ssa_cap(out);
+    size_t len = _ssa_len(out);
+    const uint64_t mask = _PACK_MASK(esz);
+    uint8_t *buf = out;
+    size_t i;
+    for(i = st->pos; i < ilen; i++) {
+        const uint64_t v = _pack_load(ints, i, esz);
+        const uint64_t d = (v - st->prev) & mask;
+        const size_t room = cap - len;
+        if(room >= _PACK_VARINT_MAX) {
+            //plenty of room, write straight into out
+            len += _pack_put_varint(buf+len, d);
+        }
+        else {
+            //near the end, only write it if the whole varint fits
+            uint8_t tmp[_PACK_VARINT_MAX];
+            size_t n = _pack_put_varint(tmp, d);
+            if(n > room) {
+                //an empty out has to fit at least one varint or this never moves
+                assert(len && "out smaller than SSA_VBYTE_BOUND(1, esz)");
+                break;
+            }
+            memcpy(buf+len, tmp, n);
+            len += n;
+        }
+        st->prev = v;
+    }
+    _ssa_set_len(out, len);
+    size_t count = i - st->pos;
+    st->pos = i;
+    return count;
+}
+
+size_t ssa_vbyte_decode_next(struct ssa_pack_stream *st, void *ints, const void *in)
+{
+    SSA_ASSERT_INIT(ints);
+    SSA_ASSERT_INIT(in);
+    assert(_ssa_esz(in) == 1);
+    const size_t esz = _ssa_esz(ints);
+    assert((esz == 4) || (esz == 8));
+    const uint64_t mask = _PACK_MASK(esz);
+    const size_t cap = _ssa_cap(ints);
+    size_t len = _ssa_len(ints);
+    const uint8_t *start = in;
+    const uint8_t *p = start + st->pos;
+    const uint8_t *end = start + _ssa_len(in);
+    size_t count = 0;
+    int truncated = 0;
+    if(st->corrupt) {
+        return 0;
+    }
+    while((len < cap) && (p < end)) {
+        uint64_t d;
+        if(*p < 0x80) {
+            //single byte deltas are the common case for sorted data
+            d = *p++;
+        }
+        else {
+            size_t n = _pack_get_varint(p, end, mask, &d);
+            if(n == _PACK_BAD_VARINT) {
+                st->corrupt = 1;
+                break;
+            }
+            if(!n) {
+                truncated = 1;
+                break;
+            }
+            p += n;
+        }
+        st->prev = (st->prev + d) & mask;
+        _pack_store(ints, len++, esz, st->prev);
+        count++;
+    }
+    //a full in that starts with a partial varint can never be finished
+    assert((!truncated || (p > start) || (_ssa_len(in) < _ssa_cap(in))) && "in smaller than SSA_VBYTE_BOUND(1, esz)");
+    _ssa_set_len(ints, len);
+    st->pos = p - start;
+    return count;
+}
+
+//packs the SSA_PACK_BLOCK values in u into payload, bw bits each
+static void _bitpack_pack(uint8_t *payload, const uint64_t *u, unsigned bw)
+{
+    //each lane gets bw words to hold its SSA_PACK_BLOCK/4 values
+    uint32_t words[4][64];
+    memset(words, 0, sizeof(words));
+    for(unsigned j = 0; j < SSA_PACK_BLOCK; j++) {
+        uint32_t *lane = words[j%4];
+        uint64_t v = u[j];
+        unsigned o = (j/4)*bw;
+        unsigned left = bw;
+        while(left) {
+            unsigned s = o%32;
+            unsigned take = SUC_MIN(32-s, left);
+            lane[o/32] |= (uint32_t)(v << s);
+            v >>= take;
+            o += take;
+            left -= take;
+        }
+    }
+    for(unsigned w = 0; w < bw; w++) {
+        for(unsigned l = 0; l < 4; l++) {
+            _pack_wr32(payload+(w*4+l)*4, words[l][w]);
+        }
+    }
+}
+
+//unpacks the SSA_PACK_BLOCK values of bw bits each in payload into u, adding ref to each
+static void _bitpack_unpack(const uint8_t *payload, unsigned bw, uint64_t ref, uint64_t *u)
+{
+    const uint64_t vmask = bw < 64 ? ((uint64_t)1 << bw) - 1 : UINT64_MAX;
+    for(unsigned j = 0; j < SSA_PACK_BLOCK; j++) {
+        const uint8_t *lane = payload + (j%4)*4;
+        uint64_t v = 0;
+        unsigned o = (j/4)*bw;
+        unsigned got = 0;
+        while(got < bw) {
+            unsigned s = o%32;
+            v |= (uint64_t)(_pack_rd32(lane+(o/32)*16) >> s) << got;
+            got += 32-s;
+            o += 32-s;
+        }
+        u[j] = (v & vmask) + ref;
+    }
+}
+
+#if defined(__SSE2__)
+//same as _bitpack_unpack for 32 bit values, but does a full row of 4 lanes at a time
+static void _bitpack_unpack32_sse2(const uint8_t *payload, unsigned bw, uint32_t ref, uint32_t *u)
+{
+    const __m128i vref = _mm_set1_epi32((int)ref);
+    if(!bw) {
+        //no payload at all, everything is ref
+        for(unsigned j = 0; j < SSA_PACK_BLOCK; j += 4) {
+            _mm_storeu_si128((__m128i*)(u+j), vref);
+        }
+        return;
+    }
+    const __m128i vmask = _mm_set1_epi32(bw < 32 ? (int)((1u << bw) - 1) : -1);
+    for(unsigned k = 0; k < SSA_PACK_BLOCK/4; k++) {
+        unsigned o = k*bw;
+        unsigned w = o/32;
+        unsigned s = o%32;
+        __m128i v = _mm_loadu_si128((const __m128i*)(payload+w*16));
+        v = _mm_srl_epi32(v, _mm_cvtsi32_si128(s));
+        if(s+bw > 32) {
+            //value straddles two words
+            __m128i hi = _mm_loadu_si128((const __m128i*)(payload+(w+1)*16));
+            v = _mm_or_si128(v, _mm_sll_epi32(hi, _mm_cvtsi32_si128(32-s)));
+        }
+        v = _mm_add_epi32(_mm_and_si128(v, vmask), vref);
+        _mm_storeu_si128((__m128i*)(u+k*4), v);
+    }
+}
+
+//in place running sum of the SSA_PACK_BLOCK deltas in u, starting from prev
+static void _bitpack_prefix32_sse2(uint32_t *u, uint32_t prev)
+{
+    __m128i carry = _mm_set1_epi32((int)prev);
+    for(unsigned j = 0; j < SSA_PACK_BLOCK; j += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(u+j));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128((__m128i*)(u+j), x);
+        carry = _mm_shuffle_epi32(x, 0xff);
+    }
+}
+#endif
+
+size_t ssa_bitpack_encode_next(struct ssa_pack_stream *st, void *out, const void *ints)
+{
+    SSA_ASSERT_INIT(out);
+    SSA_ASSERT_INIT(ints);
+    assert(_ssa_esz(out) == 1);
+    const size_t esz = _ssa_esz(ints);
+    assert((esz == 4) || (esz == 8));
+    const size_t ilen = _ssa_len(ints);
+    const size_t cap = _ssa_cap(out);
+    size_t len = _ssa_len(out);
+    const uint64_t mask = _PACK_MASK(esz);
+    uint8_t *buf = out;
+    size_t i = st->pos;
+    while(i < ilen) {
+        const size_t n = SUC_MIN(ilen - i, (size_t)SSA_PACK_BLOCK);
+        uint64_t u[SSA_PACK_BLOCK];
+        uint64_t prev = st->prev;
+        //deltas, ref is the smallest one after the first
+        uint64_t ref = UINT64_MAX;
+        for(size_t j = 0; j < n; j++) {
+            const uint64_t v = _pack_load(ints, i+j, esz);
+            u[j] = (v - prev) & mask;
+            prev = v;
+            if(j && (u[j] < ref)) {
+                ref = u[j];
+            }
+        }
+        if(n == 1) {
+            ref = 0;
+        }
+        const uint64_t d0 = u[0];
+        //the first delta is stored on its own so a big jump doesn't blow up bw
+        uint64_t maxv = 0;
+        u[0] = 0;
+        for(size_t j = 1; j < n; j++) {
+            u[j] -= ref;
+            maxv |= u[j];
+        }
+        memset(u+n, 0, (SSA_PACK_BLOCK-n)*sizeof(u[0]));
+        const unsigned bw = _pack_bits(maxv);
+
+        uint8_t hdr[2+2*_PACK_VARINT_MAX];
+        size_t hlen = 0;
+        hdr[hlen++] = (uint8_t)bw;
+        hdr[hlen++] = (uint8_t)n;
+        hlen += _pack_put_varint(hdr+hlen, d0);
+        hlen += _pack_put_varint(hdr+hlen, ref);
+        if(hlen + bw*16 > cap - len) {
+            //an empty out has to fit at least one block or this never moves
+            assert(len && "out smaller than SSA_BITPACK_BOUND(SSA_PACK_BLOCK, esz)");
+            break;
+        }
+        memcpy(buf+len, hdr, hlen);
+        _bitpack_pack(buf+len+hlen, u, bw);
+        len += hlen + bw*16;
+        st->prev = prev;
+        i += n;
+    }
+    _ssa_set_len(out, len);
+    size_t count = i - st->pos;
+    st->pos = i;
+    return count;
+}
+
+size_t ssa_bitpack_decode_next(struct ssa_pack_stream *st, void *ints, const void *in)
+{
+    SSA_ASSERT_INIT(ints);
+    SSA_ASSERT_INIT(in);
+    assert(_ssa_esz(in) == 1);
+    const size_t esz = _ssa_esz(ints);
+    assert((esz == 4) || (esz == 8));
+    const uint64_t mask = _PACK_MASK(esz);
+    const size_t cap = _ssa_cap(ints);
+    size_t len = _ssa_len(ints);
+    const uint8_t *start = in;
+    const uint8_t *p = start + st->pos;
+    const uint8_t *end = start + _ssa_len(in);
+    size_t count = 0;
+    int truncated = 0;
+    if(st->corrupt) {
+        return 0;
+    }
+    while(p < end) {
+        if(end - p < 2) {
+            truncated = 1;
+            break;
+        }
+        const unsigned bw = p[0];
+        const size_t n = p[1];
+        uint64_t d0, ref;
+        size_t a, b = 0;
+        if((bw > esz*8) || !n || (n > SSA_PACK_BLOCK)) {
+            st->corrupt = 1;
+            break;
+        }
+        //not enough room in ints, stop here
+        if(n > cap - len) {
+            break;
+        }
+        a = _pack_get_varint(p+2, end, mask, &d0);
+        if(a && (a != _PACK_BAD_VARINT)) {
+            b = _pack_get_varint(p+2+a, end, mask, &ref);
+        }
+        if((a == _PACK_BAD_VARINT) || (b == _PACK_BAD_VARINT)) {
+            st->corrupt = 1;
+            break;
+        }
+        if(!a || !b) {
+            truncated = 1;
+            break;
+        }
+        const uint8_t *payload = p+2+a+b;
+        if((size_t)(end - payload) < bw*16) {
+            truncated = 1;
+            break;
+        }
+#if defined(__SSE2__)
+        if(esz == 4) {
+            uint32_t u[SSA_PACK_BLOCK];
+            _bitpack_unpack32_sse2(payload, bw, (uint32_t)ref, u);
+            u[0] = (uint32_t)d0;
+            _bitpack_prefix32_sse2(u, (uint32_t)st->prev);
+            memcpy((uint32_t*)ints + len, u, n*sizeof(u[0]));
+            st->prev = u[n-1];
+        }
+        else
+#endif
+        {
+            uint64_t u[SSA_PACK_BLOCK];
+            _bitpack_unpack(payload, bw, ref, u);
+            u[0] = d0;
+            uint64_t prev = st->prev;
+            for(size_t j = 0; j < n; j++) {
+                prev = (prev + u[j]) & mask;
+                _pack_store(ints, len+j, esz, prev);
+            }
+            st->prev = prev;
+        }
+        len += n;
+        count += n;
+        p = payload + bw*16;
+    }
+    //a full in that starts with a partial block can never be finished
+    assert((!truncated || (p > start) || (_ssa_len(in) < _ssa_cap(in))) && "in smaller than SSA_BITPACK_BOUND(SSA_PACK_BLOCK, esz)");
+    _ssa_set_len(ints, len);
+    st->pos = p - start;
+    return count;
+}
+
+
+/*** TEST stuff *****/
+#if defined(SUC_TEST_MAIN)
+#include <assert.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#define TEST_N 1000
+
+struct test_u32 {
+    struct ssa_attr attr;
+    uint32_t array[TEST_N];
+};
+
+struct test_u64 {
+    struct ssa_attr attr;
+    uint64_t array[TEST_N];
+};
+
+struct test_bytes {
+    struct ssa_attr attr;
+    //big enough for either codec
+    uint8_t array[SSA_VBYTE_BOUND(TEST_N, 8)];
+};
+
+//small buffers to push things through in chunks, the smallest either codec allows
+struct test_chunk {
+    struct ssa_attr attr;
+    uint8_t array[SSA_BITPACK_BOUND(SSA_PACK_BLOCK, 4)];
+};
+
+struct test_u32_chunk {
+    struct ssa_attr attr;
+    uint32_t array[SSA_PACK_BLOCK*2];
+};
+
+static struct test_u32 t32, r32, s32;
+static struct test_u64 t64, r64;
+static struct test_bytes tb, sb;
+static struct test_chunk tc;
+static struct test_u32_chunk tr;
+
+//simple xorshift so the tests are repeatable
+static uint64_t test_rand(void)
+{
+    static uint64_t x = 88172645463325252ull;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+}
+
+typedef size_t (*test_enc_fn)(struct ssa_pack_stream*, void*, const void*);
+typedef size_t (*test_dec_fn)(struct ssa_pack_stream*, void*, const void*);
+
+//encode ints through the small chunk buffer into sb, then decode sb in chunks through tr into s32
+static void test_stream32(const uint32_t *ints, test_enc_fn enc, test_dec_fn dec)
+{
+    struct ssa_pack_stream st = SSA_PACK_STREAM_INIT;
+    uint8_t *c = ssa_new_empty(&tc.attr, tc.array);
+    uint8_t *b = ssa_new_empty(&sb.attr, sb.array);
+    while(st.pos < ssa_length(ints)) {
+        assert(enc(&st, c, ints));
+        ssa_cat(b, c, ssa_size(c));
+        ssa_clear(c);
+    }
+    printf("  %zu elements -> %zu bytes\n", ssa_length(ints), ssa_length(b));
+
+    struct ssa_pack_stream dt = SSA_PACK_STREAM_INIT;
+    uint32_t *r = ssa_new_empty(&tr.attr, tr.array);
+    uint32_t *s = ssa_new_empty(&s32.attr, s32.array);
+    size_t fed = 0;
+    ssa_clear(c);
+    while(ssa_length(s) < ssa_length(ints)) {
+        //keep what wasn't consumed and top up from sb
+        size_t keep = ssa_length(c) - dt.pos;
+        memmove(c, c+dt.pos, keep);
+        ssa_resize(c, keep);
+        dt.pos = 0;
+        size_t add = SUC_MIN(ssa_avail(c), ssa_length(b)-fed);
+        ssa_cat(c, b+fed, add);
+        fed += add;
+        dec(&dt, r, c);
+        assert(!dt.corrupt);
+        ssa_cat_ssa(s, r);
+        ssa_clear(r);
+    }
+    assert(fed == ssa_length(b));
+    assert(dt.pos == ssa_length(c));
+    assert(ssa_length(s) == ssa_length(ints));
+    assert(!memcmp(s, ints, ssa_size(ints)));
+}
+
+int main(void)
+{
+    uint32_t *a32 = ssa_new_empty(&t32.attr, t32.array);
+    uint32_t *d32 = ssa_new_empty(&r32.attr, r32.array);
+    uint64_t *a64 = ssa_new_empty(&t64.attr, t64.array);
+    uint64_t *d64 = ssa_new_empty(&r64.attr, r64.array);
+    uint8_t *b = ssa_new_empty(&tb.attr, tb.array);
+    size_t n;
+
+    //sorted ids with small gaps, and timestamps with a big starting value
+    uint32_t id = 5;
+    uint64_t ts = 1500000000000000ull;
+    for(int i=0; i<TEST_N; i++) {
+        id += test_rand()%50;
+        ts += 1000 + test_rand()%3000;
+        ssa_push(a32, id);
+        ssa_push(a64, ts);
+    }
+    assert(ssa_length(a32) == TEST_N);
+    assert(ssa_length(a64) == TEST_N);
+
+    puts("\nTest vbyte 32");
+    n = ssa_vbyte_encode(b, a32);
+    assert(n == TEST_N);
+    printf("  %zu bytes -> %zu bytes\n", ssa_size(a32), ssa_length(b));
+    //every delta is < 128
+    assert(ssa_length(b) == TEST_N);
+    n = ssa_vbyte_decode(d32, b);
+    assert(n == TEST_N);
+    assert(!memcmp(d32, a32, ssa_size(a32)));
+
+    puts("\nTest vbyte 64");
+    ssa_clear(b);
+    n = ssa_vbyte_encode(b, a64);
+    assert(n == TEST_N);
+    printf("  %zu bytes -> %zu bytes\n", ssa_size(a64), ssa_length(b));
+    assert(ssa_length(b) < ssa_size(a64)/2);
+    n = ssa_vbyte_decode(d64, b);
+    assert(n == TEST_N);
+    assert(!memcmp(d64, a64, ssa_size(a64)));
+
+    puts("\nTest bitpack 32");
+    ssa_clear(b);
+    ssa_clear(d32);
+    n = ssa_bitpack_encode(b, a32);
+    assert(n == TEST_N);
+    printf("  %zu bytes -> %zu bytes\n", ssa_size(a32), ssa_length(b));
+    assert(ssa_length(b) < ssa_size(a32)/4);
+    n = ssa_bitpack_decode(d32, b);
+    assert(n == TEST_N);
+    assert(!memcmp(d32, a32, ssa_size(a32)));
+
+    puts("\nTest bitpack 64");
+    ssa_clear(b);
+    ssa_clear(d64);
+    n = ssa_bitpack_encode(b, a64);
+    assert(n == TEST_N);
+    printf("  %zu bytes -> %zu bytes\n", ssa_size(a64), ssa_length(b));
+    assert(ssa_length(b) < ssa_size(a64)/4);
+    n = ssa_bitpack_decode(d64, b);
+    assert(n == TEST_N);
+    assert(!memcmp(d64, a64, ssa_size(a64)));
+
+    puts("\nTest unsorted/full width values");
+    ssa_clear(a32);
+    ssa_clear(a64);
+    for(int i=0; i<TEST_N; i++) {
+        ssa_push(a32, (uint32_t)test_rand());
+        ssa_push(a64, test_rand());
+    }
+    //a run of equal values gives bw == 0
+    for(int i=300; i<300+SSA_PACK_BLOCK; i++) {
+        a32[i] = 7;
+    }
+    ssa_clear(b);
+    ssa_clear(d32);
+    assert(ssa_vbyte_encode(b, a32) == TEST_N);
+    assert(ssa_vbyte_decode(d32, b) == TEST_N);
+    assert(!memcmp(d32, a32, ssa_size(a32)));
+    ssa_clear(b);
+    ssa_clear(d32);
+    assert(ssa_bitpack_encode(b, a32) == TEST_N);
+    assert(ssa_bitpack_decode(d32, b) == TEST_N);
+    assert(!memcmp(d32, a32, ssa_size(a32)));
+    ssa_clear(b);
+    ssa_clear(d64);
+    assert(ssa_vbyte_encode(b, a64) == TEST_N);
+    assert(ssa_vbyte_decode(d64, b) == TEST_N);
+    assert(!memcmp(d64, a64, ssa_size(a64)));
+    ssa_clear(b);
+    ssa_clear(d64);
+    assert(ssa_bitpack_encode(b, a64) == TEST_N);
+    assert(ssa_length(b) <= SSA_BITPACK_BOUND(TEST_N, 8));
+    assert(ssa_bitpack_decode(d64, b) == TEST_N);
+    assert(!memcmp(d64, a64, ssa_size(a64)));
+
+    puts("\nTest out of room");
+    //only room for part of the output, nothing past a whole varint/block gets written
+    ssa_clear(b);
+    ssa_clear(d32);
+    n = ssa_vbyte_encode(b, a32);
+    ssa_resize(b, 10);
+    assert(ssa_vbyte_decode(d32, b) < 4);
+    ssa_clear(d32);
+    ssa_clear(b);
+    ssa_bitpack_encode(b, a32);
+    ssa_resize(b, ssa_length(b)-1);
+    n = ssa_bitpack_decode(d32, b);
+    assert(n == TEST_N - TEST_N%SSA_PACK_BLOCK);
+
+    puts("\nTest streaming");
+    ssa_clear(a32);
+    id = 0;
+    for(int i=0; i<TEST_N; i++) {
+        id += test_rand()%300;
+        ssa_push(a32, id);
+    }
+    test_stream32(a32, ssa_vbyte_encode_next, ssa_vbyte_decode_next);
+    test_stream32(a32, ssa_bitpack_encode_next, ssa_bitpack_decode_next);
+    //full width values make every block as big as it gets
+    ssa_clear(a32);
+    for(int i=0; i<TEST_N; i++) {
+        ssa_push(a32, (uint32_t)test_rand());
+    }
+    test_stream32(a32, ssa_vbyte_encode_next, ssa_vbyte_decode_next);
+    test_stream32(a32, ssa_bitpack_encode_next, ssa_bitpack_decode_next);
+
+    puts("\nTest corrupt input");
+    struct ssa_pack_stream st = SSA_PACK_STREAM_INIT;
+    ssa_clear(d32);
+    ssa_clear(b);
+    //a valid delta, then a varint that never ends
+    ssa_push(b, 3);
+    ssa_push_n(b, 0xff, 11);
+    assert(ssa_vbyte_decode_next(&st, d32, b) == 1);
+    assert(st.corrupt);
+    assert(st.pos == 1);
+    //stays stuck instead of looking like it needs more input
+    assert(ssa_vbyte_decode_next(&st, d32, b) == 0);
+    //a truncated varint isn't corrupt, it just waits for more
+    memset(&st, 0, sizeof(st));
+    ssa_resize(b, 4);
+    assert(ssa_vbyte_decode_next(&st, d32, b) == 1);
+    assert(!st.corrupt);
+    assert(st.pos == 1);
+    //5 byte varint too big for a uint32_t
+    memset(&st, 0, sizeof(st));
+    ssa_clear(b);
+    ssa_push_n(b, 0xff, 4);
+    ssa_push(b, 0x1f);
+    assert(ssa_vbyte_decode_next(&st, d32, b) == 0);
+    assert(st.corrupt);
+    //fits in a uint64_t
+    memset(&st, 0, sizeof(st));
+    ssa_clear(d64);
+    assert(ssa_vbyte_decode_next(&st, d64, b) == 1);
+    assert(!st.corrupt);
+
+    //bitpack headers, bw too big for the element size, n out of range
+    const uint8_t bad[][4] = {{33, 1, 0, 0}, {5, 0, 0, 0}, {5, SSA_PACK_BLOCK+1, 0, 0}};
+    for(int i=0; i<SUC_LEN(bad); i++) {
+        memset(&st, 0, sizeof(st));
+        ssa_clear(d32);
+        ssa_clear(b);
+        ssa_cat(b, bad[i], sizeof(bad[i]));
+        assert(ssa_bitpack_decode_next(&st, d32, b) == 0);
+        assert(st.corrupt);
+        assert(st.pos == 0);
+    }
+    //bad varint in a good block header
+    memset(&st, 0, sizeof(st));
+    ssa_clear(b);
+    ssa_push(b, 0);
+    ssa_push(b, 1);
+    ssa_push_n(b, 0xff, 11);
+    assert(ssa_bitpack_decode_next(&st, d32, b) == 0);
+    assert(st.corrupt);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,157 @@
+/* libsuc - Simple utilities for C
+ *
+ * Integer compression codecs between simple static arrays.
+ *
+ * Copyright (c) 2017 - Devin Linnington
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _SUC_PACK_H_
+#define _SUC_PACK_H_
+
+#include "suc_ssa.h"
+
+/**
+ * Both codecs take an ssa of uint32_t or uint64_t (esz 4 or 8) and append to
+ * an ssa of bytes (esz 1), or the reverse. Each value is stored as the delta
+ * from the one before it, wrapping at the element width, so any input round
+ * trips but sorted input with small gaps is what compresses well.
+ *
+ * vbyte:   each delta as a little-endian base 128 varint, 1 byte per delta < 128.
+ * bitpack: blocks of SSA_PACK_BLOCK deltas, each block stored as
+ *            [bw:u8][n:u8][first delta:varint][ref:varint][payload]
+ *          ref is the smallest of the other deltas and payload is (delta-ref)
+ *          packed in bw bits each. The payload is 4 interleaved lanes of
+ *          little-endian 32-bit words, value j goes in lane j%4, so decoding
+ *          unpacks 4 values at a time with SSE2 when it's available.
+ */
+
+//number of values in each bitpack block
+#define SSA_PACK_BLOCK 128
+
+//worst case bytes needed to vbyte encode n elements of size esz
+#define SSA_VBYTE_BOUND(n, esz) ((n)*((esz)*8+6)/7)
+
+//worst case bytes needed to bitpack encode n elements of size esz
+#define SSA_BITPACK_BOUND(n, esz) (((n)+SSA_PACK_BLOCK-1)/SSA_PACK_BLOCK*(22+(esz)*SSA_PACK_BLOCK))
+
+/**
+ * State kept between calls of the *_next functions, so a large input can be
+ * processed in chunks through a small output ssa.
+ * Zero it, or init with SSA_PACK_STREAM_INIT, before the first call.
+ *
+ * The byte ssa chunks have to hold at least one worst case varint/block, or a
+ * call on an empty out (encode) or a full in (decode) can't make progress and
+ * asserts: SSA_VBYTE_BOUND(1, esz) bytes for vbyte,
+ * SSA_BITPACK_BOUND(SSA_PACK_BLOCK, esz) bytes for bitpack.
+ */
+struct ssa_pack_stream {
+    //last value encoded/decoded, the next delta is taken from it
+    uint64_t prev;
+    //next element (encode) or byte (decode) of the input ssa to process
+    size_t pos;
+    //set by the decoders when the input at pos can never be decoded
+    int corrupt;
+};
+
+#define SSA_PACK_STREAM_INIT {.prev=0, .pos=0, .corrupt=0}
+
+/**
+ * Delta+varint encode ints[st->pos...] onto the end of byte ssa out, stopping
+ * early if out fills up. Advances st->pos past everything that was encoded.
+ *
+ * ex:
+ * struct ssa_pack_stream st = SSA_PACK_STREAM_INIT;
+ * while(st.pos < ssa_length(ints)) {
+ *     ssa_vbyte_encode_next(&st, out, ints);
+ *     fwrite(out, 1, ssa_length(out), f);
+ *     ssa_clear(out);
+ * }
+ *
+ * returns: Number of elements encoded by this call
+ */
+size_t ssa_vbyte_encode_next(struct ssa_pack_stream *st, void *out, const void *ints);
+
+/**
+ * Decode byte ssa in[st->pos...] onto the end of ssa ints, stopping early if
+ * ints fills up or in ends partway through a varint. Advances st->pos past
+ * everything that was decoded, anything left after it has to be kept at the
+ * front of in when refilling it with the next chunk.
+ * A varint that's too long or too big for the element size sets st->corrupt
+ * and stops at it, refilling won't help. Once set, this returns 0 right away.
+ *
+ * returns: Number of elements decoded by this call
+ */
+size_t ssa_vbyte_decode_next(struct ssa_pack_stream *st, void *ints, const void *in);
+
+/**
+ * Frame-of-reference bitpack ints[st->pos...] onto the end of byte ssa out,
+ * one block at a time, stopping before a block that won't fit in out.
+ * Loop on it the same as ssa_vbyte_encode_next.
+ * Input that isn't a multiple of SSA_PACK_BLOCK long ends with a partial
+ * block, so feed chunks that are to get the best ratio.
+ *
+ * returns: Number of elements encoded by this call
+ */
+size_t ssa_bitpack_encode_next(struct ssa_pack_stream *st, void *out, const void *ints);
+
+/**
+ * Decode bitpacked byte ssa in[st->pos...] onto the end of ssa ints, one block
+ * at a time, stopping before a block that's incomplete in in or won't fit in
+ * ints. Size ints as a multiple of SSA_PACK_BLOCK so every block fits.
+ * A block header that can't be valid sets st->corrupt the same as
+ * ssa_vbyte_decode_next.
+ *
+ * returns: Number of elements decoded by this call
+ */
+size_t ssa_bitpack_decode_next(struct ssa_pack_stream *st, void *ints, const void *in);
+
+//delta+varint encode all of ssa ints onto the end of byte ssa out, returns number of elements encoded
+static inline size_t ssa_vbyte_encode(void *out, const void *ints)
+{
+    struct ssa_pack_stream st = SSA_PACK_STREAM_INIT;
+    return ssa_vbyte_encode_next(&st, out, ints);
+}
+
+//decode all of byte ssa in onto the end of ssa ints, returns number of elements decoded
+static inline size_t ssa_vbyte_decode(void *ints, const void *in)
+{
+    struct ssa_pack_stream st = SSA_PACK_STREAM_INIT;
+    return ssa_vbyte_decode_next(&st, ints, in);
+}
+
+//bitpack all of ssa ints onto the end of byte ssa out, returns number of elements encoded
+static inline size_t ssa_bitpack_encode(void *out, const void *ints)
+{
+    struct ssa_pack_stream st = SSA_PACK_STREAM_INIT;
+    return ssa_bitpack_encode_next(&st, out, ints);
+}
+
+//decode all of bitpacked byte ssa in onto the end of ssa ints, returns number of elements decoded
+static inline size_t ssa_bitpack_decode(void *ints, const void *in)
+{
+    struct ssa_pack_stream st = SSA_PACK_STREAM_INIT;
+    return ssa_bitpack_decode_next(&st, ints, in);
+}
+
+#endif //_SUC_PACK_H_
@@ -33,45 +33,48 @@
 void ssa_resize(void *array, size_t new_length)
 {
     SSA_ASSERT_INIT(array);
-    struct ssa_attr *attr = SSA_HDR(array);
+    const size_t len = _ssa_len(array);
+    const size_t esz = _ssa_esz(array);
     char *buf = array;
-    if(attr->len == new_length) {
+    if(len == new_length) {
         return;
     }
-    if(attr->len < new_length) {
+    if(len < new_length) {
         //make sure there is room
-        new_length = SUC_MIN(attr->alloc/attr->esz, new_length);
+        new_length = SUC_MIN(_ssa_cap(array), new_length);
         //need to zero out the new mem
-        size_t count = (new_length-attr->len)*attr->esz;
-        memset(buf+attr->len*attr->esz, 0, count);
+        size_t count = (new_length-len)*esz;
+        memset(buf+len*esz, 0, count);
     }
-    attr->len = new_length;
+    _ssa_set_len(array, new_length);
 }
 
 //copy the contents of other into ssa array at index i
 void ssa_cpy(void *array, size_t i, const void *other, size_t other_size)
 {
     SSA_ASSERT_INIT(array);
-    struct ssa_attr *attr = SSA_HDR(array);
+    const size_t len = _ssa_len(array);
+    const size_t esz = _ssa_esz(array);
+    const size_t cap = _ssa_cap(array);
     char *buf = array;
     //if i is too big, other/other_size aren't set
-    if((i > attr->alloc/attr->esz) || !other || !other_size) {
+    if((i > cap) || !other || !other_size) {
         return;
     }
     //if i is beyond the length of the array, zero out the difference
-    if(i > attr->len) {
-        size_t count = (i-attr->len)*attr->esz;
-        memset(buf+attr->len*attr->esz, 0, count);
+    if(i > len) {
+        size_t count = (i-len)*esz;
+        memset(buf+len*esz, 0, count);
     }
-    char *start = buf+i*attr->esz;
+    char *start = buf+i*esz;
     //end of the allocated array or the end of other
-    char *end = SUC_MIN(buf+attr->alloc, start+other_size);
+    char *end = SUC_MIN(buf+cap*esz, start+other_size);
     //copy as many bytes from other as we can
     memcpy(start, other, end-start);
     //only set len if it grew
-    size_t new_length = (end-buf)/attr->esz;
-    if(new_length > attr->len) {
-        attr->len = new_length;
+    size_t new_length = (end-buf)/esz;
+    if(new_length > len) {
+        _ssa_set_len(array, new_length);
     }
 }
 
@@ -80,25 +83,67 @@ void ssa_slice(const void *array, size_t start, size_t end, void *slice)
 {
     SSA_ASSERT_INIT(array);
     SSA_ASSERT_INIT(slice);
-    const struct ssa_attr *attr = SSA_HDR(array);
+    const size_t len = _ssa_len(array);
+    const size_t esz = _ssa_esz(array);
     const char *buf = array;
-    struct ssa_attr *oattr = SSA_HDR(slice);
-    assert(attr->esz == oattr->esz);
+    assert(esz == _ssa_esz(slice));
     //end has to be > start, no support for -ve indexes right now
     if(end < start) return;
-    size_t slice_sz = (end-start)*attr->esz;
     //indexes must be in bounds, slice length must be <= slice's allocated size
-    if((start >= attr->len) || (end >= attr->len) || (slice_sz > oattr->alloc)) {
+    if((start >= len) || (end >= len) || (end-start > _ssa_cap(slice))) {
         return;
     }
-    const char *start_ptr = buf+start*attr->esz;
-    ssa_cpy(slice, 0, start_ptr, slice_sz);
-    //we already checked that slice_sz can fit in slice, so set its new len
-    oattr->len = (end-start);
+    const char *start_ptr = buf+start*esz;
+    ssa_cpy(slice, 0, start_ptr, (end-start)*esz);
+    //we already checked that the slice can fit, so set its new len
+    _ssa_set_len(slice, end-start);
+}
+
+//insert the contents of other into ssa array before index i, moving the rest up
+void ssa_insert(void *array, size_t i, const void *other, size_t other_size)
+{
+    SSA_ASSERT_INIT(array);
+    const size_t len = _ssa_len(array);
+    const size_t esz = _ssa_esz(array);
+    char *buf = array;
+    assert(other_size%esz==0);
+    const size_t n = other_size/esz;
+    if((i > len) || !other || !n || (n > _ssa_cap(array) - len)) {
+        return;
+    }
+    char *gap = buf+i*esz;
+    const char *src = other;
+    //if other is part of this array, the bit of it at or after i moves up with everything else
+    size_t before = other_size;
+    size_t shift = 0;
+    if(((uintptr_t)src >= (uintptr_t)buf) && ((uintptr_t)src < (uintptr_t)(buf+len*esz))) {
+        before = src < gap ? SUC_MIN((size_t)(gap-src), other_size) : 0;
+        shift = n*esz;
+    }
+    //one move to open the gap, then fill it
+    memmove(gap+n*esz, gap, (len-i)*esz);
+    memcpy(gap, src, before);
+    memcpy(gap+before, src+before+shift, other_size-before);
+    _ssa_set_len(array, len+n);
+}
+
+//remove n elements of ssa array starting at index i, moving the rest down
+void ssa_erase(void *array, size_t i, size_t n)
+{
+    SSA_ASSERT_INIT(array);
+    const size_t len = _ssa_len(array);
+    const size_t esz = _ssa_esz(array);
+    char *buf = array;
+    if(i >= len) {
+        return;
+    }
+    n = SUC_MIN(n, len-i);
+    memmove(buf+i*esz, buf+(i+n)*esz, (len-i-n)*esz);
+    _ssa_set_len(array, len-n);
 }
 
 //helper method
-void* _ssa_new(struct ssa_attr *attr, void *array, size_t alloc, size_t esz, const void *init, size_t init_sz)
+void* _ssa_new(void *attr, void *array, size_t alloc, size_t esz, const void *init, size_t init_sz, uint8_t magic)
 {
     //we must init an even number of elements
     assert(init_sz%esz==0);
@@ -107,19 +152,40 @@ void* _ssa_new(struct ssa_attr *attr, void *array, size_t alloc, size_t esz, con
     
     //store the array-ssa_attr in the padding and/or the _pdiff member
     *SSA_PDIFF(array) = buf-(char*)attr;
-    //magic number used for kinda meh error checking
-    *SSA_PMAGIC(array) = SSA_MAGIC;
-    
-    attr->alloc = alloc;
-    attr->esz = esz;
+    //magic number used for kinda meh error checking, and to tell which kind of header this is
+    *SSA_PMAGIC(array) = magic;
+    
+    switch(magic) {
+        case SSA_MAGIC16: {
+            struct ssa_attr16 *a = attr;
+            //compact headers count elements, make sure they fit
+            assert(alloc/esz <= UINT16_MAX);
+            a->alloc = alloc/esz;
+            a->esz = esz;
+            break;
+        }
+        case SSA_MAGIC32: {
+            struct ssa_attr32 *a = attr;
+            assert(alloc/esz <= UINT32_MAX);
+            a->alloc = alloc/esz;
+            a->esz = esz;
+            break;
+        }
+        default: {
+            struct ssa_attr *a = attr;
+            a->alloc = alloc;
+            a->esz = esz;
+            break;
+        }
+    }
     
     if(init && init_sz) {
         size_t count = SUC_MIN(alloc, init_sz);
         memcpy(buf, init, count);
-        attr->len = count/esz;
+        _ssa_set_len(array, count/esz);
     }
     else {
-        attr->len = 0;
+        _ssa_set_len(array, 0);
     }
     //a bit meaningless, but return a ptr to buf
     return array;
@@ -130,6 +196,7 @@ void* _ssa_new(struct ssa_attr *attr, void *array, size_t alloc, size_t esz, con
 #if defined(SUC_TEST_MAIN)
 #include <assert.h>
 #include <stdio.h>
+#include "suc_range.h"
 #include <stdint.h>
 #include <inttypes.h>
 
@@ -139,6 +206,18 @@ struct test_uint{
     uint32_t padding[4];
 };
 
+struct test_tiny16{
+    struct ssa_attr16 attr;
+    uint32_t array[4];
+    uint32_t padding[1];
+};
+
+struct test_tiny32{
+    struct ssa_attr32 attr;
+    //needs padding between attr and array
+    uint64_t array[4];
+};
+
 void print_ssa_attr(struct ssa_attr *attr)
 {
     printf("ptr     %p\n", attr);
@@ -312,6 +391,197 @@ int main(void) {
     }
     assert(ssa_length(a1) == 0);
     
+    
+    puts("\nTest foreach");
+    ssa_replace(a1, a2);
+    j = 0;
+    ssa_foreach(v, a1) {
+        assert(v == a1[j]);
+        j++;
+    }
+    assert(j == ssa_length(a1));
+    
+    //break/continue behave like a normal loop
+    j = 0;
+    ssa_foreach(v, a1, 4) {
+        if(v == 0) continue;
+        if(v == 5) break;
+        j++;
+    }
+    assert(j == 4);
+    
+    ssa_foreach_ptr(p, a1, 8) {
+        *p += 1;
+    }
+    for(i=0; i<ssa_length(a1); i++) {
+        assert(a1[i] == a2[i]+1);
+    }
+    
+    //nothing to do for an empty array
+    ssa_clear(a1);
+    ssa_foreach_ptr(p, a1) {
+        assert(0 && "empty");
+    }
+    
+    puts("\nTest foreach_range");
+    ssa_replace(a1, a2);
+    j = 0;
+    ssa_foreach_range(p, a1, &range(1, 9, 3)) {
+        assert(p == a1 + 1 + j*3);
+        j++;
+    }
+    assert(j == 3);
+    
+    //going down, and past the end of the array gets cut off
+    j = 0;
+    ssa_foreach_range_pf(p, a1, 2, &range(ssa_length(a1)-1, -5, -2)) {
+        printf("a1[%td] = %u\n", p-a1, *p);
+        assert(p == a1 + ssa_length(a1)-1 - j*2);
+        j++;
+    }
+    assert(j == ssa_length(a1)/2);
+    j = 0;
+    ssa_foreach_range(p, a1, &range(5, 1000)) {
+        j++;
+    }
+    assert(j == ssa_length(a1)-5);
+    ssa_foreach_range(p, a1, &range(ssa_length(a1), 1000)) {
+        assert(0 && "out of range");
+    }
+    
+    
+    puts("\nTest compact headers");
+    struct test_tiny16 s1;
+    struct test_tiny32 s2;
+    uint64_t *b2;
+    s1.padding[0] = 0x5a5a5a5a;
+    assert(sizeof(struct ssa_attr16) == 8);
+    a1 = ssa_new(&s1.attr, s1.array, d1, 2*sizeof(d1[0]));
+    assert(*SSA_PMAGIC(a1) == SSA_MAGIC16);
+    assert(SSA_HDR16(a1) == &s1.attr);
+    assert(s1.attr.alloc == SUC_LEN(s1.array));
+    assert(ssa_length(a1) == 2);
+    assert(ssa_avail(a1) == 2);
+    assert(ssa_size(a1) == 2*sizeof(a1[0]));
+    //fill it up, but no further
+    for(i=0; i<10; i++) {
+        ssa_push(a1, 100+i);
+    }
+    assert(ssa_length(a1) == SUC_LEN(s1.array));
+    assert(s1.padding[0] == 0x5a5a5a5a);
+    assert(ssa_get(a1, 3) == 101);
+    assert(ssa_pop(a1) == 101);
+    assert(*ssa_pop_ptr(a1) == 100);
+    assert(ssa_length(a1) == 2);
+    ssa_resize(a1, 10);
+    assert(ssa_length(a1) == SUC_LEN(s1.array));
+    assert(a1[3] == 0);
+    ssa_cat(a1, d1, sizeof(d1));
+    assert(s1.padding[0] == 0x5a5a5a5a);
+    
+    //mixing compact and full headers
+    ssa_slice(a2, 2, 5, a1);
+    assert(ssa_length(a1) == 3);
+    assert(a1[0] == a2[2]);
+    ssa_replace(a2, a1);
+    assert(ssa_length(a2) == 3);
+    j = 0;
+    ssa_foreach(v, a1) {
+        assert(v == a2[j]);
+        j++;
+    }
+    assert(j == 3);
+    ssa_clear(a1);
+    assert(ssa_length(a1) == 0);
+    
+    b2 = ssa_new_empty(&s2.attr, s2.array);
+    assert(*SSA_PMAGIC(b2) == SSA_MAGIC32);
+    assert(SSA_HDR32(b2) == &s2.attr);
+    assert(*SSA_PDIFF(b2) == (char*)s2.array - (char*)&s2.attr);
+    assert(ssa_avail(b2) == SUC_LEN(s2.array));
+    ssa_push(b2, 0x123456789ull);
+    assert(ssa_length(b2) == 1);
+    assert(ssa_get(b2, 0) == 0x123456789ull);
+    
+    
+    puts("\nTest push_n/extend_from_range");
+    ssa_clear(a1);
+    a2 = ssa_new_empty(&t2.attr, t2.array);
+    assert(ssa_push_n(a2, 7, 3) == 3);
+    assert(ssa_length(a2) == 3);
+    assert(a2[2] == 7);
+    assert(ssa_extend_from_range(a2, &range(5)) == 5);
+    assert(a2[3] == 0);
+    assert(a2[7] == 4);
+    assert(ssa_extend_from_range(a2, &range(100, 70, -3)) == 10);
+    assert(a2[8] == 100);
+    assert(a2[17] == 73);
+    //only room for 2 more
+    assert(ssa_extend_from_range(a2, &range(1000)) == 2);
+    assert(a2[19] == 1);
+    assert(ssa_avail(a2) == 0);
+    assert(ssa_push_n(a2, 1, 5) == 0);
+    assert(ssa_extend_from_range(a2, &range(1000)) == 0);
+    
+    puts("\nTest insert/erase");
+    ssa_clear(a2);
+    ssa_cat(a2, d1, sizeof(d1));
+    ssa_insert(a2, 3, d1, 2*sizeof(d1[0]));
+    assert(ssa_length(a2) == SUC_LEN(d1)+2);
+    assert(a2[2] == 2);
+    assert(a2[3] == 0);
+    assert(a2[4] == 1);
+    assert(a2[5] == 3);
+    assert(a2[11] == 9);
+    //past the end, and too big, do nothing
+    ssa_insert(a2, 13, d1, sizeof(d1[0]));
+    ssa_insert(a2, 0, d1, sizeof(d1));
+    assert(ssa_length(a2) == SUC_LEN(d1)+2);
+    //at the end is the same as cat
+    ssa_insert(a2, ssa_length(a2), d1, sizeof(d1[0]));
+    assert(a2[12] == 0);
+    ssa_erase(a2, 3, 2);
+    ssa_erase(a2, ssa_length(a2)-1, 100);
+    assert(ssa_length(a2) == SUC_LEN(d1));
+    assert(!memcmp(a2, d1, sizeof(d1)));
+    ssa_erase(a2, ssa_length(a2), 1);
+    assert(ssa_length(a2) == SUC_LEN(d1));
+    
+    //inserting part of the same array, after, before and straddling i
+    ssa_insert(a2, 0, a2+5, 2*sizeof(a2[0]));
+    assert(a2[0] == 5);
+    assert(a2[1] == 6);
+    assert(a2[2] == 0);
+    assert(a2[11] == 9);
+    ssa_erase(a2, 0, 2);
+    ssa_insert(a2, 8, a2+1, 2*sizeof(a2[0]));
+    assert(a2[7] == 7);
+    assert(a2[8] == 1);
+    assert(a2[9] == 2);
+    assert(a2[10] == 8);
+    ssa_erase(a2, 8, 2);
+    ssa_insert(a2, 4, a2+3, 3*sizeof(a2[0]));
+    const uint32_t straddle[] = {0, 1, 2, 3, 3, 4, 5, 4, 5, 6};
+    assert(!memcmp(a2, straddle, sizeof(straddle)));
+    ssa_erase(a2, 4, 3);
+    assert(ssa_length(a2) == SUC_LEN(d1));
+    assert(!memcmp(a2, d1, sizeof(d1)));
+    
+    puts("\nTest reserve/commit tail");
+    size_t n;
+    uint32_t *tail = ssa_reserve_tail(a2, &n);
+    assert(tail == a2 + SUC_LEN(d1));
+    assert(n == ssa_avail(a2));
+    //nothing added until commit
+    tail[0] = 42;
+    tail[1] = 43;
+    assert(ssa_length(a2) == SUC_LEN(d1));
+    ssa_commit_tail(a2, 2);
+    assert(ssa_length(a2) == SUC_LEN(d1)+2);
+    assert(ssa_get(a2, SUC_LEN(d1)+1) == 43);
+    ssa_commit_tail(a2, 1000);
+    assert(ssa_avail(a2) == 0);
+    
     return 0;
 }
 #endif
@@ -30,10 +30,18 @@
 #define _SUC_SSA_H_
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <assert.h>
 #include <string.h>
 #include <stdint.h>
 
+#include "suc_macros.h"
+
+//only used through pointers here, include suc_range.h to make one
+struct _suc_range;
+//from suc_range.c, for ssa_extend_from_range
+int _suc_calc_end(const struct _suc_range *r);
+
 #ifndef SSA_SIZE_TYPE
 #define SSA_SIZE_TYPE size_t
 #endif
@@ -51,6 +59,33 @@ struct ssa_attr {
     uint8_t _pdiff;
 };
 
+/**
+ * Compact headers for lots of small arrays, used in place of struct ssa_attr.
+ * alloc is counted in elements instead of bytes, so an ssa_attr16 can hold up
+ * to 65535 elements of any size in an 8 byte header (vs 24 for ssa_attr).
+ * Which one is in use is kept in the magic number, so all the ssa_* functions
+ * work the same on any of them.
+ */
+struct ssa_attr32 {
+    //num elements allocated
+    uint32_t alloc;
+    //num of used elements
+    uint32_t len;
+    uint16_t esz;
+    uint8_t _pmagic;
+    uint8_t _pdiff;
+};
+
+struct ssa_attr16 {
+    //num elements allocated
+    uint16_t alloc;
+    //num of used elements
+    uint16_t len;
+    uint16_t esz;
+    uint8_t _pmagic;
+    uint8_t _pdiff;
+};
+
 #if 0 //an example
 //type can be called whatever you like
 struct some_type {
@@ -59,6 +94,12 @@ struct some_type {
     //but must appear directly above your array
     int stuff[100];
 };
+
+//same thing with a compact header
+struct tiny_type {
+    struct ssa_attr16 whatever;
+    int stuff[4];
+};
 #endif
 
 //get a pointer to the diff between array and ssa_attr
@@ -67,11 +108,78 @@ struct some_type {
 #define SSA_PMAGIC(array) (uint8_t*)((char*)array-2)
 //something with a fair number of bits set and also prime, making it more unlikely to be found in "random" data
 #define SSA_MAGIC 0xa7
+//same idea, for the compact headers
+#define SSA_MAGIC32 0xb5
+#define SSA_MAGIC16 0xd3
 //macro to raise an error if the array hasn't been initialized with ssa_new*
-#define SSA_ASSERT_INIT(array) assert(*SSA_PMAGIC(array) == SSA_MAGIC && "not initialized")
+#define SSA_ASSERT_INIT(array) assert(_ssa_magic_ok(*SSA_PMAGIC(array)) && "not initialized")
 
 //get the ssa header used to keep attributes from an array
 #define SSA_HDR(array) ((struct ssa_attr*)(((char *)array)-*SSA_PDIFF(array)))
+//same but for the compact headers, only use the one that matches *SSA_PMAGIC(array)
+#define SSA_HDR32(array) ((struct ssa_attr32*)(((char *)array)-*SSA_PDIFF(array)))
+#define SSA_HDR16(array) ((struct ssa_attr16*)(((char *)array)-*SSA_PDIFF(array)))
+
+//magic number for the kind of header pointed to by attr
+#define SSA_MAGIC_OF(attr) _Generic((attr), \
+    struct ssa_attr32*: SSA_MAGIC32, \
+    struct ssa_attr16*: SSA_MAGIC16, \
+    default: SSA_MAGIC)
+
+//most elements the kind of header pointed to by attr can count
+#define _SSA_CAP_MAX(attr) _Generic((attr), \
+    struct ssa_attr32*: (size_t)UINT32_MAX, \
+    struct ssa_attr16*: (size_t)UINT16_MAX, \
+    default: SIZE_MAX)
+
+//fail the build if array has more elements than the header can count
+#define _SSA_CHECK_CAP(attr, array) \
+    _Static_assert(sizeof(array)/sizeof((array)[0]) <= _SSA_CAP_MAX(attr), "array too big for its ssa header")
+
+static inline int _ssa_magic_ok(uint8_t magic)
+{
+    return (magic == SSA_MAGIC) || (magic == SSA_MAGIC32) || (magic == SSA_MAGIC16);
+}
+
+//number of used elements, for any kind of header
+static inline size_t _ssa_len(const void *array)
+{
+    switch(*SSA_PMAGIC(array)) {
+        case SSA_MAGIC16: return SSA_HDR16(array)->len;
+        case SSA_MAGIC32: return SSA_HDR32(array)->len;
+        default: return SSA_HDR(array)->len;
+    }
+}
+
+//set number of used elements, for any kind of header
+static inline void _ssa_set_len(void *array, size_t len)
+{
+    switch(*SSA_PMAGIC(array)) {
+        case SSA_MAGIC16: SSA_HDR16(array)->len = len; break;
+        case SSA_MAGIC32: SSA_HDR32(array)->len = len; break;
+        default: SSA_HDR(array)->len = len; break;
+    }
+}
+
+//size of each element, for any kind of header
+static inline size_t _ssa_esz(const void *array)
+{
+    switch(*SSA_PMAGIC(array)) {
+        case SSA_MAGIC16: return SSA_HDR16(array)->esz;
+        case SSA_MAGIC32: return SSA_HDR32(array)->esz;
+        default: return SSA_HDR(array)->esz;
+    }
+}
+
+//number of elements allocated, for any kind of header
+static inline size_t _ssa_cap(const void *array)
+{
+    switch(*SSA_PMAGIC(array)) {
+        case SSA_MAGIC16: return SSA_HDR16(array)->alloc;
+        case SSA_MAGIC32: return SSA_HDR32(array)->alloc;
+        default: return SSA_HDR(array)->alloc/SSA_HDR(array)->esz;
+    }
+}
 
 /** initializes a new array of len 0, returning a pointer to the array
  * container: pointer to the struct containing the array and the ssa_attr
@@ -81,44 +189,44 @@ struct some_type {
 #define ssa_new_empty(ssa_attr, array) ({ \
     __typeof__(ssa_attr) ts = &(*ssa_attr); /*ssa_attr must be a ptr*/ \
     __typeof__(array[0])* ta = &(*array); /*array must be a ptr*/ \
-    (__typeof__(array[0])*)_ssa_new(ts, ta, sizeof(array), sizeof(array[0]), NULL, 0); \
+    _SSA_CHECK_CAP(ts, array); \
+    (__typeof__(array[0])*)_ssa_new(ts, ta, sizeof(array), sizeof(array[0]), NULL, 0, SSA_MAGIC_OF(ts)); \
     })
 
 //makes a new array based on an existing one
 #define ssa_new(ssa_attr, array, init, init_size) ({ \
     __typeof__(ssa_attr) ts = &(*ssa_attr); /*ssa_attr must be a ptr*/ \
     __typeof__(array[0])* ta = &(*array); /*array must be a ptr*/ \
-    (__typeof__(array[0])*)_ssa_new(ts, ta, sizeof(array), sizeof(array[0]), (init), (init_size)); \
+    _SSA_CHECK_CAP(ts, array); \
+    (__typeof__(array[0])*)_ssa_new(ts, ta, sizeof(array), sizeof(array[0]), (init), (init_size), SSA_MAGIC_OF(ts)); \
     })
 
 //length of array in use
 static inline size_t ssa_length(const void *array)
 {
     SSA_ASSERT_INIT(array);
-    return SSA_HDR(array)->len;
+    return _ssa_len(array);
 }
 
 //size of the array that's been used, len*sizeof(array[0])
 static inline size_t ssa_size(const void *array)
 {
     SSA_ASSERT_INIT(array);
-    const struct ssa_attr *attr = SSA_HDR(array);
-    return attr->len*attr->esz;
+    return _ssa_len(array)*_ssa_esz(array);
 }
 
 //available number of elements in array that are not in use, alloc/sizeof(array[0])-len
 static inline size_t ssa_avail(const void *array)
 {
     SSA_ASSERT_INIT(array);
-    const struct ssa_attr *attr = SSA_HDR(array);
-    return attr->alloc/attr->esz - attr->len;
+    return _ssa_cap(array) - _ssa_len(array);
 }
 
 //clear an array, setting length=0
 static inline void ssa_clear(void *array)
 {
     SSA_ASSERT_INIT(array);
-    SSA_HDR(array)->len = 0;
+    _ssa_set_len(array, 0);
 }
 
 //resize length, zeroing new elements if expanding
@@ -130,7 +238,7 @@ void ssa_cpy(void *array, size_t i, const void *other, size_t other_size);
 //copy the contents of other onto the end of ssa array
 static inline void ssa_cat(void *array, const void *other, size_t other_size)
 {
-    ssa_cpy(array, SSA_HDR(array)->len, other, other_size);
+    ssa_cpy(array, _ssa_len(array), other, other_size);
 }
 
 //copy the contents of ssa other_ssa onto the end of ssa array
@@ -138,11 +246,9 @@ static inline void ssa_cat_ssa(void *array, const void *other_ssa)
 {
     SSA_ASSERT_INIT(array);
     SSA_ASSERT_INIT(other_ssa);
-    struct ssa_attr *attr = SSA_HDR(array);
-    const struct ssa_attr *oattr = SSA_HDR(other_ssa);
-    assert(attr->esz == oattr->esz);
+    assert(_ssa_esz(array) == _ssa_esz(other_ssa));
     //won't do anything if other_ssa is too big
-    ssa_cpy(array, attr->len, other_ssa, oattr->len*oattr->esz);
+    ssa_cpy(array, _ssa_len(array), other_ssa, ssa_size(other_ssa));
 }
 
 //copy the contents of ssa other_ssa over the contents of ssa array, setting ssa array's size to that of ssa other_ssa
@@ -150,61 +256,232 @@ static inline void ssa_replace(void *array, const void *other_ssa)
 {
     SSA_ASSERT_INIT(array);
     SSA_ASSERT_INIT(other_ssa);
-    struct ssa_attr *attr = SSA_HDR(array);
-    const struct ssa_attr *oattr = SSA_HDR(other_ssa);
-    assert(attr->esz == oattr->esz);
+    assert(_ssa_esz(array) == _ssa_esz(other_ssa));
     ssa_cpy(array, 0, other_ssa, ssa_size(other_ssa));
-    //ssa_cpy will already set attr->length if it grew, so set it here only if it shrunk
-    if(oattr->len < attr->len) {
-        attr->len = oattr->len;
+    //ssa_cpy will already set the length if it grew, so set it here only if it shrunk
+    const size_t olen = _ssa_len(other_ssa);
+    if(olen < _ssa_len(array)) {
+        _ssa_set_len(array, olen);
     }
 }
 
 //copies a portion of ssa array to ssa slice, replacing its contents
 void ssa_slice(const void *array, size_t start, size_t end, void *slice);
 
+//insert the contents of other into ssa array before index i, moving the rest up
+//other can be part of array itself, won't do anything if i is past the end or other doesn't fit
+void ssa_insert(void *array, size_t i, const void *other, size_t other_size);
+
+//remove n elements of ssa array starting at index i, moving the rest down
+void ssa_erase(void *array, size_t i, size_t n);
+
+//make the first n elements returned by ssa_reserve_tail part of ssa array, up to what's available
+static inline void ssa_commit_tail(void *array, size_t n)
+{
+    SSA_ASSERT_INIT(array);
+    const size_t len = _ssa_len(array);
+    _ssa_set_len(array, len + SUC_MIN(n, _ssa_cap(array) - len));
+}
+
 //safely push/append value to the end of an ssa array, if there is room
 //value and typeof(array) must be an assignable type, otherwise use ssa_cat
 #define ssa_push(array, value) do { \
-    struct ssa_attr *attr = SSA_HDR(array); \
-    if(attr->len < attr->alloc*attr->esz) { \
-        (array)[attr->len] = (value); \
-        attr->len++; \
+    const size_t tl = _ssa_len(array); \
+    if(tl < _ssa_cap(array)) { \
+        (array)[tl] = (value); \
+        _ssa_set_len((array), tl+1); \
     } }while(0)
 
+//push n copies of value to the end of an ssa array, as many as there's room for
+//returns: number of elements pushed
+#define ssa_push_n(array, value, n) ({ \
+    const size_t tl = _ssa_len(array); \
+    const size_t tn = SUC_MIN((size_t)(n), _ssa_cap(array) - tl); \
+    const __typeof__((array)[0]) tv = (value); \
+    for(size_t tk = 0; tk < tn; tk++) { (array)[tl+tk] = tv; } \
+    _ssa_set_len((array), tl+tn); \
+    tn; \
+    })
+
+/**
+ * Fill the end of an ssa array with the values of a pointer to a suc_range,
+ * as many as there's room for. The fill loops are kept simple enough for the
+ * compiler to vectorize.
+ * Include suc_range.h to use it, and link suc_range.o.
+ *
+ * ex:
+ * ssa_extend_from_range(a1, &range(10, 0, -1));
+ *
+ * returns: number of elements added
+ */
+#define ssa_extend_from_range(array, ...) ({ \
+    const struct _suc_range *tr = (__VA_ARGS__); \
+    const size_t tl = _ssa_len(array); \
+    const int te = _suc_calc_end(tr); \
+    const size_t tn = te > 0 ? SUC_MIN((size_t)te, _ssa_cap(array) - tl) : 0; \
+    __typeof__(&(array)[0]) td = (array) + tl; \
+    const __typeof__((array)[0]) ts = tr->start; \
+    if(tr->step == 1) { \
+        for(size_t tk = 0; tk < tn; tk++) { td[tk] = ts + (__typeof__((array)[0]))tk; } \
+    } \
+    else { \
+        const __typeof__((array)[0]) tp = tr->step; \
+        for(size_t tk = 0; tk < tn; tk++) { td[tk] = ts + (__typeof__((array)[0]))tk*tp; } \
+    } \
+    _ssa_set_len((array), tl+tn); \
+    tn; \
+    })
+
+/**
+ * Get a pointer to the unused end of an ssa array to write into directly,
+ * setting *count to how many elements are there. Nothing is added until
+ * ssa_commit_tail is called with how many were written.
+ *
+ * ex:
+ * size_t n;
+ * uint32_t *p = ssa_reserve_tail(a1, &n);
+ * n = fread(p, sizeof(*p), n, f);
+ * ssa_commit_tail(a1, n);
+ */
+#define ssa_reserve_tail(array, count) ({ \
+    const size_t tl = _ssa_len(array); \
+    *(count) = _ssa_cap(array) - tl; \
+    (array) + tl; \
+    })
+
 //pop an item off the end of an ssa array, if there is one
 #define ssa_pop(array) ({ \
-    struct ssa_attr *attr = SSA_HDR(array); \
-    const size_t ti = attr->len; \
-    ti ? (array)[--attr->len] : 0; \
+    const size_t ti = _ssa_len(array); \
+    if(ti) { _ssa_set_len((array), ti-1); } \
+    ti ? (array)[ti-1] : 0; \
     })
     
 //pop a pointer to the value at the end of an ssa array, if there is one
 #define ssa_pop_ptr(array) ({ \
-    struct ssa_attr *attr = SSA_HDR(array); \
-    const size_t ti = attr->len; \
-    ti ? (array) + --attr->len : NULL; \
+    const size_t ti = _ssa_len(array); \
+    if(ti) { _ssa_set_len((array), ti-1); } \
+    ti ? (array) + ti-1 : NULL; \
     })
 
 //safely get an element of ssa array at an index
 #define ssa_get(array, i) ({ \
-    const struct ssa_attr *attr = SSA_HDR(array); \
     const size_t ti = (i); \
-    ti < attr->len ? (array)[ti] : 0; \
+    ti < _ssa_len(array) ? (array)[ti] : 0; \
     })
 
 //safely set an element of ssa array at an index
 // value must be assignable, otherwise use ssa_cpy
 #define ssa_set(array, i, value) do { \
-    const struct ssa_attr *attr = SSA_HDR(array); \
     const size_t ti = (i); \
-    if(ti < attr->len) { (array)[ti] = (value); } \
+    if(ti < _ssa_len(array)) { (array)[ti] = (value); } \
     } while(0)
 
+/**
+ * Loop a copy of each used element of ssa array into var, the header is only
+ * read once and the loop is a plain pointer walk the compiler can unroll
+ * (-funroll-loops). Optionally prefetch dist elements ahead, for arrays of big
+ * elements where the hardware prefetcher can't keep up.
+ * var has only inner scope.
+ *
+ * ssa_foreach(var, array)
+ * ssa_foreach(var, array, dist)
+ *
+ * ex:
+ * ssa_foreach(x, a1) {
+ *     sum += x;
+ * }
+ */
+#define ssa_foreach(...) SUC_VFUNC(_ssa_foreach_, __VA_ARGS__)
+
+/**
+ * Same as ssa_foreach but var is a pointer to each element, so they can be
+ * modified in place.
+ *
+ * ssa_foreach_ptr(var, array)
+ * ssa_foreach_ptr(var, array, dist)
+ *
+ * ex:
+ * ssa_foreach_ptr(p, a1) {
+ *     p->count++;
+ * }
+ */
+#define ssa_foreach_ptr(...) SUC_VFUNC(_ssa_foreach_ptr_, __VA_ARGS__)
+
+/**
+ * Loop a pointer var over the elements of ssa array at the indexes given by a
+ * pointer to a suc_range. Indexes outside of the used part of the array end
+ * the loop, so it's safe to pass a range longer than the array.
+ * Include suc_range.h to use it, suc_ssa.h doesn't pull it in.
+ * Not a SUC_VFUNC like the others since range(...) expands to something with
+ * commas in it, use ssa_foreach_range_pf to prefetch dist steps ahead.
+ *
+ * ssa_foreach_range(var, array, range)
+ *
+ * ex:
+ * //every other element, backwards from 10
+ * ssa_foreach_range(p, a1, &range(10, -1, -2)) {
+ *     printf("%u\n", *p);
+ * }
+ *
+ * ssa_foreach_range_pf(var, array, dist, range)
+ */
+#define ssa_foreach_range(var, array, ...) _ssa_foreach_range(var, array, 0, __VA_ARGS__)
+#define ssa_foreach_range_pf(var, array, dist, ...) _ssa_foreach_range(var, array, dist, __VA_ARGS__)
+
 
 /************** Internal stuff *************/
 
+//hint the cpu to start loading the element dist after p, this doesn't fault so it's fine to go past the end
+#define _SSA_PREFETCH(p, dist) _ssa_prefetch((p), (ptrdiff_t)(dist)*(ptrdiff_t)sizeof(*(p)))
+
+static inline void _ssa_prefetch(const void *p, ptrdiff_t offset)
+{
+    if(offset) {
+        __builtin_prefetch((const void*)((uintptr_t)p + offset));
+    }
+}
+
+#define _ssa_foreach_2(var, array) _ssa_foreach_3(var, array, 0)
+#define _ssa_foreach_3(var, array, dist) \
+    for(__typeof__(&(array)[0]) _sp = (array), _se = _sp + ssa_length(_sp); _sp; _sp = NULL) \
+    /* _sk is only left set if the body breaks */ \
+    for(int _sk = 1; _sk && (_sp < _se); _sk = !_sk, _SSA_PREFETCH(_sp, dist), _sp++) \
+    for(__typeof__((array)[0]) var = *_sp; _sk; _sk = 0)
+
+#define _ssa_foreach_ptr_2(var, array) _ssa_foreach_ptr_3(var, array, 0)
+#define _ssa_foreach_ptr_3(var, array, dist) \
+    for(__typeof__(&(array)[0]) var = (array), _se = var + ssa_length(var); var; var = NULL) \
+    for(; var < _se; _SSA_PREFETCH(var, dist), var++)
+
+//range is last so commas in it don't matter
+#define _ssa_foreach_range(var, array, dist, ...) \
+    for(const struct _suc_range *_r = (__VA_ARGS__); _r; _r = NULL) \
+    for(__typeof__(&(array)[0]) _sp = (array), var = _sp; _sp; _sp = NULL) \
+    for(size_t _i = 0, _end = _ssa_range_count(_r->start, _r->stop, _r->step, ssa_length(_sp)); \
+        (_i < _end) && ((var = _sp + _r->start + (ptrdiff_t)_i*_r->step), 1); \
+        _SSA_PREFETCH(var, (ptrdiff_t)(dist)*_r->step), _i++)
+
+//number of steps a range can take before leaving the indexes [0, len)
+//takes the fields instead of a suc_range since that's only forward declared here
+static inline size_t _ssa_range_count(int start, int stop, int step, size_t len)
+{
+    if((start < 0) || ((size_t)start >= len) || (step == 0)) {
+        return 0;
+    }
+    //steps until stop, and until falling off the end of the array
+    size_t to_stop, to_edge;
+    if(step > 0) {
+        to_stop = stop > start ? 1 + ((size_t)stop - 1 - start)/step : 0;
+        to_edge = 1 + (len - 1 - start)/step;
+    }
+    else {
+        to_stop = stop < start ? 1 + ((size_t)start - 1 - stop)/(size_t)(0-step) : 0;
+        to_edge = 1 + (size_t)start/(size_t)(0-step);
+    }
+    return SUC_MIN(to_stop, to_edge);
+}
+
 //helper method
-void* _ssa_new(struct ssa_attr *attr, void *array, size_t alloc, size_t esz, const void *init, size_t init_sz);
+void* _ssa_new(void *attr, void *array, size_t alloc, size_t esz, const void *init, size_t init_sz, uint8_t magic);
 
 #endif //_SUC_SSA_H_